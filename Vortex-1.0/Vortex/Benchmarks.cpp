@@ -141,9 +141,11 @@ void Benchmark<ItemType>::Usage(void) {
 	printf("	Vortex /c file1 file2	    <------ file copy\n");
 	printf("	Vortex /s <GB> iterations   <------ sort\n");
 	printf("	Vortex /p <GB>              <------ producer-consumer\n");
+	printf("	Vortex /b <GB>              <------ bucket scatter under each page coloring\n");
 #else
 	printf("	./Vortex /s <GB> iterations <------ sort\n");
 	printf("	./Vortex /p <GB>            <------ producer-consumer\n");
+	printf("	./Vortex /b <GB>            <------ bucket scatter under each page coloring\n");
 #endif
 	exit(0);
 }
@@ -165,6 +167,8 @@ void Benchmark<ItemType>::Run(int argc, char** argv) {
 #endif
 		else if (argv[1][1] == 's' && argc == 4)
 			type = 4;
+		else if (argv[1][1] == 'b' && argc == 3)
+			type = 5;
 		else
 			Usage();
 	}
@@ -257,8 +261,10 @@ void Benchmark<ItemType>::Run(int argc, char** argv) {
 		uint64_t blockSizePower = 20;
 		Syscall.SetAffinity(0);
 
-		// setup the Vortex sort buckets
+		// setup the Vortex sort buckets; dominated by pre-faulting the pool
+		void* setup = Syscall.StartTimer();
 		VortexSort<ItemType>* vs = new VortexSort<ItemType>(itemsPerSort, blockSizePower);
+		printf("\tsetup %.3f sec\n", Syscall.EndTimer(setup));
 
 		// prepare the input stream
 		ItemType* inputBuf, *outputBuf;
@@ -287,7 +293,61 @@ void Benchmark<ItemType>::Run(int argc, char** argv) {
 			// reset the input buffer
 			inputS->Reset();
 		}
+
+		// hand the peak footprint back to the OS
+		uint64_t released = vs->sp->Trim();
+		printf("\tTrim released %.2f GB\n", (double)(released << vs->sp->pageSizePower) / (1 << 30));
 		delete inputS;
 		delete vs;
 	}
+	// bucket scatter into VortexS streams under different page colorings
+	else if (type == 5) {
+		uint64_t GB             = atoi(argv[2]);
+		uint64_t items          = GB * (1LLU << 30) / sizeof(ItemType);
+		uint64_t memory         = items * sizeof(ItemType);
+		uint64_t blockSizePower = 20;
+		uint64_t nBuckets       = 256;
+		uint64_t shift          = sizeof(ItemType) * 8 - 8;
+		Syscall.SetAffinity(0);
+
+		VortexCpuId cpuId;
+		printf("Running %llu GB bucket scatter; L2 %llu KB %llu-way, LLC %llu KB %llu-way\n", GB,
+			cpuId.l2Size >> 10, cpuId.l2Ways, cpuId.llcSize >> 10, cpuId.llcWays);
+
+		// uniformly random keys outside of Vortex
+		ItemType* keys = (ItemType*)Syscall.AllocAligned(memory, 64);
+		RunLoop<ItemType>((char*)keys, memory, WRITER_LCG, false);
+
+		// one pool for all runs; pre-allocated so that no run pays for growing it
+		StreamPool* sp      = new StreamPool(blockSizePower);
+		sp->AdjustPoolPhysicalMemory((memory >> sp->pageSizePower) + 2 * nBuckets * sp->pagesPerBlock);
+		VortexS**   streams = new VortexS*[nBuckets];
+		ItemType**  heads   = new ItemType*[nBuckets];
+
+		// no stagger, the detected geometry, and the legacy default
+		uint64_t    schemes[3] = { 1, cpuId.PageColors(sp->pageSize), DEFAULT_COLORS };
+		const char* names[3]   = { "none", "detected", "default" };
+		for (int s = 0; s < 3; s++) {
+			sp->SetColors(schemes[s]);
+			for (uint64_t i = 0; i < nBuckets; i++) {
+				streams[i] = new VortexS(memory, memory, sp, i);
+				heads[i]   = (ItemType*)streams[i]->GetWriteBuf();
+			}
+
+			// scatter by the top byte of each key
+			void* start = Syscall.StartTimer();
+			for (uint64_t j = 0; j < items; j++) {
+				ItemType key = keys[j];
+				*heads[key >> shift]++ = key;
+			}
+			double elapsed = Syscall.EndTimer(start);
+			printf("\t%-8s colors %4llu: %.2f M/s\n", names[s], schemes[s], (double)items / elapsed / 1e6);
+
+			for (uint64_t i = 0; i < nBuckets; i++) delete streams[i];
+		}
+		delete[] heads;
+		delete[] streams;
+		delete sp;
+		Syscall.DeallocAligned(keys);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+/*--------------------------------------------------------------------------------------------
+ - Vortex: Extreme-Performance Memory Abstractions for Data-Intensive Streaming Applications -
+ - Copyright(C) 2020 Carson Hanel, Arif Arman, Di Xiao, John Keech, Dmitri Loguinov          -
+ - Produced via research carried out by the Texas A&M Internet Research Lab                  -
+ -                                                                                           -
+ - This program is free software : you can redistribute it and/or modify                     -
+ - it under the terms of the GNU General Public License as published by                      -
+ - the Free Software Foundation, either version 3 of the License, or                         -
+ - (at your option) any later version.                                                       -
+ -                                                                                           -
+ - This program is distributed in the hope that it will be useful,                           -
+ - but WITHOUT ANY WARRANTY; without even the implied warranty of                            -
+ - MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the                               -
+ - GNU General Public License for more details.                                              -
+ -                                                                                           -
+ - You should have received a copy of the GNU General Public License                         -
+ - along with this program. If not, see < http://www.gnu.org/licenses/>.                     -
+ --------------------------------------------------------------------------------------------*/
+#include "stdafx.h"
+
+// global Vortex memoryGovernor
+MemoryGovernor memoryGovernor;
+
+// sets up an unlimited governor
+MemoryGovernor::MemoryGovernor() {
+	cs      = (CSType*)Syscall.MakeCS();
+	cv      = (CVType*)Syscall.MakeCV();
+	budget  = UINT64_MAX;
+	used    = 0;
+	timeout = GOVERNOR_TIMEOUT;
+}
+
+MemoryGovernor::~MemoryGovernor() {
+	Syscall.DeleteCV(cv);
+	Syscall.DeleteCS(cs);
+}
+
+// returns the account of a registered pool, requires mutex
+PoolAccount* MemoryGovernor::Find(StreamPool* pool) {
+	for (list<PoolAccount>::iterator it = accounts.begin(); it != accounts.end(); it++)
+		if (it->pool == pool) return &*it;
+	ReportError("StreamPool %p is not registered with the governor\n", pool);
+	return NULL;
+}
+
+// checks if a request fits the budget without overtaking a higher-priority waiter, requires mutex
+bool MemoryGovernor::Fits(uint64_t bytes, int priority) {
+	if (used + bytes > budget) return false;
+	return waiting.empty() || priority >= *waiting.rbegin();
+}
+
+// trims free pages of pools that are not more important than the requester, requires mutex
+void MemoryGovernor::Reclaim(PoolAccount* requester, uint64_t bytes) {
+	uint64_t reclaimed = 0;
+	for (list<PoolAccount>::iterator it = accounts.begin(); it != accounts.end() && reclaimed < bytes; it++) {
+		if (&*it == requester || it->priority > requester->priority) continue;
+
+		// a pool that is busy is skipped; waiting for its lock could deadlock with its own charge
+		uint64_t released = it->pool->TryTrim();
+		it->used  -= released;
+		used      -= released;
+		reclaimed += released;
+	}
+}
+
+// limits the physical memory of all pools; pools above the new budget keep their memory until they release it
+void MemoryGovernor::SetBudget(uint64_t bytes) {
+	Syscall.EnterCS(cs);
+	budget = bytes;
+	Syscall.LeaveCS(cs);
+	Syscall.WakeAllCV(cv);
+}
+
+// sets how long a request may wait for budget before it is rejected
+void MemoryGovernor::SetTimeout(uint64_t milliseconds) {
+	Syscall.EnterCS(cs);
+	timeout = milliseconds;
+	Syscall.LeaveCS(cs);
+}
+
+// limits the physical memory of one pool; requests beyond the quota are rejected without waiting
+void MemoryGovernor::SetQuota(StreamPool* pool, uint64_t bytes) {
+	Syscall.EnterCS(cs);
+	Find(pool)->quota = bytes;
+	Syscall.LeaveCS(cs);
+}
+
+// sets the priority of a pool's requests and the protection of its free pages from reclaim
+void MemoryGovernor::SetPriority(StreamPool* pool, int priority) {
+	Syscall.EnterCS(cs);
+	Find(pool)->priority = priority;
+	Syscall.LeaveCS(cs);
+}
+
+// adds a pool with no memory, no quota and the default priority
+void MemoryGovernor::Register(StreamPool* pool) {
+	PoolAccount account;
+	account.pool = pool;
+	Syscall.EnterCS(cs);
+	accounts.push_back(account);
+	Syscall.LeaveCS(cs);
+}
+
+// removes a pool, returning everything it still holds to the budget
+void MemoryGovernor::Unregister(StreamPool* pool) {
+	Syscall.EnterCS(cs);
+	for (list<PoolAccount>::iterator it = accounts.begin(); it != accounts.end(); it++) {
+		if (it->pool != pool) continue;
+		used -= it->used;
+		accounts.erase(it);
+		break;
+	}
+	Syscall.LeaveCS(cs);
+	Syscall.WakeAllCV(cv);
+}
+
+// charges bytes to a pool only if they fit right away
+bool MemoryGovernor::TryAcquire(StreamPool* pool, uint64_t bytes) {
+	Syscall.EnterCS(cs);
+	PoolAccount* account = Find(pool);
+	bool granted         = account->used + bytes <= account->quota && Fits(bytes, account->priority);
+	if (granted) {
+		account->used += bytes;
+		used          += bytes;
+	}
+	Syscall.LeaveCS(cs);
+	return granted;
+}
+
+// charges bytes to a pool, reclaiming idle pages of other pools and then waiting for releases; 
+// false if the quota is exceeded or the budget stays short for the whole timeout
+bool MemoryGovernor::Acquire(StreamPool* pool, uint64_t bytes) {
+	Syscall.EnterCS(cs);
+	PoolAccount* account = Find(pool);
+	if (account->used + bytes > account->quota) {
+		Syscall.LeaveCS(cs);
+		return false;
+	}
+
+	// first take back pages that other pools are not using
+	if (used + bytes > budget) Reclaim(account, used + bytes - budget);
+
+	// then apply backpressure until enough is released
+	int   priority = account->priority;
+	void*  timer    = Syscall.StartTimer();
+	double waited   = 0;
+	bool   granted  = true;
+	waiting.insert(priority);
+	while (!Fits(bytes, priority)) {
+		if (waited >= timeout) {
+			granted = false;
+			break;
+		}
+		Syscall.TimedSleepCV(cv, cs, (uint64_t)(timeout - waited) + 1);
+		waited += Syscall.QueryTimer(timer) * 1e3;
+	}
+	waiting.erase(waiting.find(priority));
+	delete (TimeType*)timer;
+
+	if (granted) {
+		account->used += bytes;
+		used          += bytes;
+	}
+	Syscall.LeaveCS(cs);
+
+	// a lower-priority waiter may now be first in line
+	Syscall.WakeAllCV(cv);
+	return granted;
+}
+
+// returns bytes released by a pool to the budget
+void MemoryGovernor::Release(StreamPool* pool, uint64_t bytes) {
+	Syscall.EnterCS(cs);
+	PoolAccount* account = Find(pool);
+	account->used -= bytes;
+	used          -= bytes;
+	Syscall.LeaveCS(cs);
+	Syscall.WakeAllCV(cv);
+}
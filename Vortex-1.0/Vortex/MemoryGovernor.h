@@ -0,0 +1,68 @@
+/*--------------------------------------------------------------------------------------------
+ - Vortex: Extreme-Performance Memory Abstractions for Data-Intensive Streaming Applications -
+ - Copyright(C) 2020 Carson Hanel, Arif Arman, Di Xiao, John Keech, Dmitri Loguinov          -
+ - Produced via research carried out by the Texas A&M Internet Research Lab                  -
+ -                                                                                           -
+ - This program is free software : you can redistribute it and/or modify                     -
+ - it under the terms of the GNU General Public License as published by                      -
+ - the Free Software Foundation, either version 3 of the License, or                         -
+ - (at your option) any later version.                                                       -
+ -                                                                                           -
+ - This program is distributed in the hope that it will be useful,                           -
+ - but WITHOUT ANY WARRANTY; without even the implied warranty of                            -
+ - MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the                               -
+ - GNU General Public License for more details.                                              -
+ -                                                                                           -
+ - You should have received a copy of the GNU General Public License                         -
+ - along with this program. If not, see < http://www.gnu.org/licenses/>.                     -
+ --------------------------------------------------------------------------------------------*/
+#pragma once
+
+// default time a request may wait for budget before it is rejected
+#define GOVERNOR_TIMEOUT	5000
+
+// one StreamPool's share of the process budget
+class PoolAccount {
+public:
+	StreamPool* pool;
+	uint64_t    used     = 0;				// bytes of physical memory the pool holds
+	uint64_t    quota    = UINT64_MAX;		// bytes the pool may hold
+	int         priority = 0;				// higher priorities are served first and reclaimed last
+};
+
+// process-wide limit on the physical memory of all StreamPools
+class MemoryGovernor {
+	CSType*             cs;
+	CVType*             cv;
+	list<PoolAccount>   accounts;
+	multiset<int>       waiting;		// priorities of the requests blocked on the budget
+	uint64_t            budget;
+	uint64_t            used;
+	uint64_t            timeout;
+
+	PoolAccount*        Find(StreamPool* pool);
+	bool                Fits(uint64_t bytes, int priority);
+	void                Reclaim(PoolAccount* requester, uint64_t bytes);
+public:
+	MemoryGovernor();
+	~MemoryGovernor();
+
+	// configuration
+	void     SetBudget(uint64_t bytes);
+	void     SetTimeout(uint64_t milliseconds);
+	void     SetQuota(StreamPool* pool, uint64_t bytes);
+	void     SetPriority(StreamPool* pool, int priority);
+	uint64_t GetBudget(void) { return budget; }
+	uint64_t GetUsed(void)   { return used; }
+
+	// pool membership
+	void     Register(StreamPool* pool);
+	void     Unregister(StreamPool* pool);
+
+	// charging physical memory
+	bool     TryAcquire(StreamPool* pool, uint64_t bytes);
+	bool     Acquire(StreamPool* pool, uint64_t bytes);
+	void     Release(StreamPool* pool, uint64_t bytes);
+};
+
+extern MemoryGovernor memoryGovernor;
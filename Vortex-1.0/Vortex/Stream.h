@@ -43,7 +43,8 @@ class BlockState {
 public:
 	char*      virtualPtr = nullptr;
 	uint64_t   numPages   = 0;
-#ifdef _WIN32
+	uint64_t   node       = 0;		// NUMA node whose page stack the block came from
+#ifdef PFN_POOL
 	void*      GetPFN(void) { return (void*)(this + 1); }
 #else
 	void*      GetPFN(void) { return virtualPtr; }
@@ -25,102 +25,427 @@ StreamPool::StreamPool(uint64_t blockSizePower) : blockSizePower(blockSizePower)
 	pageSizePower      = 12;         // request 4-KB pages 
 	blockCount         = 0;		     // no physical blocks
 	pageCount          = 0;		     // no pages allocated yet
-	tail               = 0;          // top of the page stack
+	freePages          = 0;          // sum of all node stack tails
+	colors             = DEFAULT_COLORS;
+	prefault           = true;
+	trimThread         = nullptr;    // no idle trimming until requested
+	trimPeriod         = 0;
+	memset(magazines, 0, sizeof(magazines));   // magazines are created on a thread's first block request
+	nodes.resize(Syscall.NodeCount()); // one page stack per NUMA node
+	memoryGovernor.Register(this);     // all physical memory is charged to the process budget
+#ifdef VORTEX_MEMFD
+	poolFile           = Syscall.CreatePoolFile();
+	filePages          = 0;
+#endif
 	InitializePool();
 }
 
-// used by streams to expand physical memory allocated, requires mutex
-void StreamPool::AdjustPoolPhysicalMemory(uint64_t totalPageCount) {
+// used by streams to expand physical memory allocated; false if the memory governor refuses the growth
+bool StreamPool::AdjustPoolPhysicalMemory(uint64_t totalPageCount) {
+	// memory is placed on the node of the calling thread
+	uint64_t node = Syscall.GetCurrentNode() % nodes.size();
+
 	// assure that no other threads push/pop/adjust memory
 	Syscall.EnterCS(cs);
 
 	// if the StreamPool currently doesn't have enough pages, expand
-	if (totalPageCount > pageCount) 
-		ExpandPhysicalMemory(totalPageCount);
+	bool granted = true;
+	if (totalPageCount > pageCount) {
+		uint64_t extraPageCount = totalPageCount - pageCount;
+#ifndef PFN_POOL
+		extraPageCount = RoundUp(extraPageCount, pagesPerBlock);
+#endif
+		granted = ChargeGovernor(extraPageCount);
+		if (granted) ExpandPhysicalMemory(node, extraPageCount);
+	}
 
 	// yield to other threads
 	Syscall.LeaveCS(cs);
+	return granted;
 }
 
-// private function - used within the StreamPool to expand the amount of physical memory allocated
-void StreamPool::ExpandPhysicalMemory(uint64_t totalPageCount) {
-	// see if enough memory is available, or more needs to be allocated
-	uint64_t extraPageCount = totalPageCount - pageCount;
+// private function - reserves budget for extra pages; the pool lock is dropped while waiting for it, requires mutex
+bool StreamPool::ChargeGovernor(uint64_t pages) {
+	if (memoryGovernor.TryAcquire(this, pages * pageSize)) return true;
 
-#ifdef _WIN32
+	// other threads may return blocks meanwhile; callers re-check the stacks afterwards
+	Syscall.LeaveCS(cs);
+	bool granted = memoryGovernor.Acquire(this, pages * pageSize);
+	Syscall.EnterCS(cs);
+	return granted;
+}
+
+// private function - used within the StreamPool to expand the physical memory of a node by pages already 
+// charged to the governor, requires mutex
+void StreamPool::ExpandPhysicalMemory(uint64_t node, uint64_t extraPageCount) {
+	NodePool& np            = nodes[node];
+	uint64_t  nodePageCount = np.pageCount + extraPageCount;
+
+#ifdef PFN_POOL
 	// assure we allocate enough space for all PFNs
-	uint64_t bytes = totalPageCount * sizeof(BlockType);
-	if (blockCount == 0) PFN = (BlockType*)malloc(bytes);
-	else PFN = (BlockType*)realloc(PFN, bytes);
+	uint64_t bytes = nodePageCount * sizeof(BlockType);
+	if (np.PFN == nullptr) np.PFN = (BlockType*)malloc(bytes);
+	else np.PFN = (BlockType*)realloc(np.PFN, bytes);
 
 	// check if malloc/realloc was successful
-	if (!PFN) ReportError("failed malloc/realloc with error %d\n", GetLastError());
+	if (!np.PFN) ReportError("failed malloc/realloc with error %d\n", GetLastError());
 #endif
 
-	// allocate all pages at the top of the StreamPool stack
+	// allocate all pages at the top of the node's stack
 #ifdef _WIN32
 	// Windows-style physical page allocation
-	Syscall.AllocatePages(extraPageCount, pageSize, PFN + tail);
+	Syscall.AllocatePages(extraPageCount, pageSize, np.PFN + np.tail, node, prefault);
+#elif defined(VORTEX_MEMFD)
+	// memfd-style allocation; the file grows and the new page numbers are pushed on the stack
+	Syscall.AllocateFilePages(poolFile, filePages, extraPageCount, pageSize, np.PFN + np.tail, node, prefault);
+	filePages += extraPageCount;
 #else
-	// Linux-style physical page allocation
-	PFN = (BlockType*)Syscall.AllocatePages(PFN,                         // start of page array
-		                                    tail,                        // # of pages on stack
-		                                    extraPageCount,              // # of pages needed
-		                                    pageSize,                    // page byte size
-		                                    PFN + pageCount * pageSize); // end of page array
+	// Linux-style physical page allocation; commit only the new range, one slab piece at a time
+	uint64_t position = np.tail, remaining = extraPageCount;
+	while (remaining > 0) {
+		// reserve virtual space for another slab if the stack grows past the last one
+		while (np.slabs.size() <= position / slabPages) 
+			np.slabs.push_back((BlockType*)Syscall.AllocateVirtual(NULL, slabPages * pageSize, MEM_RESERVE));
+
+		uint64_t count = min(remaining, slabPages - position % slabPages);
+		Syscall.AllocatePages(count, pageSize, StackSlot(np, position), node, prefault);
+		position  += count;
+		remaining -= count;
+	}
 #endif
 	// record the total number of pages, moving the PFN stack tail
-	pageCount   = totalPageCount;
-	blockCount  = totalPageCount / pagesPerBlock;
-	tail       += extraPageCount;
+	np.pageCount  = nodePageCount;
+	np.tail      += extraPageCount;
+	pageCount    += extraPageCount;
+	freePages    += extraPageCount;
+	blockCount    = pageCount / pagesPerBlock;
+}
+
+// picks the node to serve a request; the local node unless it has run dry
+uint64_t StreamPool::SelectNode(uint64_t local, uint64_t numPages) {
+	if (nodes[local].tail >= numPages) return local;
+
+	// fall back to the remote node with the most free pages
+	uint64_t best = local;
+	for (uint64_t i = 0; i < nodes.size(); i++) 
+		if (nodes[i].tail >= numPages && nodes[i].tail > nodes[best].tail) best = i;
+	return best;
+}
+
+// returns the location of the given stack position; a PFN array slot on Windows, a page in a slab on Linux
+BlockType* StreamPool::StackSlot(NodePool& np, uint64_t position) {
+#ifdef PFN_POOL
+	return np.PFN + position;
+#else
+	return np.slabs[position / slabPages] + (position % slabPages) * pageSize;
+#endif
+}
+
+// moves a run of pages between a node's stack and contiguous space elsewhere, requires mutex
+void StreamPool::MoveRun(NodePool& np, uint64_t position, uint64_t pages, BlockType* other, bool toStack) {
+#ifdef PFN_POOL
+	if (toStack) memcpy(StackSlot(np, position), other, pages * sizeof(BlockType));
+	else         memcpy(other, StackSlot(np, position), pages * sizeof(BlockType));
+#else
+	// slabs are not adjacent in virtual memory; move one slab piece at a time
+	while (pages > 0) {
+		uint64_t count = min(pages, slabPages - position % slabPages);
+		uint64_t bytes = count * pageSize;
+		if (toStack) mremap(other, bytes, bytes, MREMAP_MAYMOVE | MREMAP_FIXED, StackSlot(np, position));
+		else         mremap(StackSlot(np, position), bytes, bytes, MREMAP_MAYMOVE | MREMAP_FIXED, other);
+		position += count;
+		pages    -= count;
+		other    += bytes;
+	}
+#endif
+}
+
+// hands out small per-thread indices shared by all pools; an index is recycled when its thread exits
+class ThreadSlot {
+	static atomic<uint64_t> used;
+public:
+	uint64_t index;
+	ThreadSlot() {
+		uint64_t mask = used.load();
+		do {
+			index = 0;
+			while (index < MAX_MAGAZINES && (mask >> index) & 1) index++;
+			if (index == MAX_MAGAZINES) return;
+		} while (!used.compare_exchange_weak(mask, mask | (1LLU << index)));
+	}
+	~ThreadSlot() {
+		if (index < MAX_MAGAZINES) used.fetch_and(~(1LLU << index));
+	}
+};
+atomic<uint64_t> ThreadSlot::used(0);
+static thread_local ThreadSlot threadSlot;
+
+// returns the calling thread's magazine, creating it on first use; NULL if the thread has no slot
+Magazine* StreamPool::LocalMagazine(void) {
+	if (threadSlot.index >= MAX_MAGAZINES) return NULL;
+
+	// a slot belongs to one live thread, so creation needs no lock
+	Magazine* m = magazines[threadSlot.index];
+	if (m == NULL) {
+		m        = new Magazine;
+		m->node  = Syscall.GetCurrentNode() % nodes.size();
+		m->count = 0;
+#ifdef PFN_POOL
+		m->slots = (BlockType*)malloc(MAGAZINE_BLOCKS * pagesPerBlock * sizeof(BlockType));
+		if (!m->slots) ReportError("failed malloc with error %d\n", GetLastError());
+#else
+		m->slots = (BlockType*)Syscall.AllocateVirtual(NULL, MAGAZINE_BLOCKS * blockSize, MEM_RESERVE);
+#endif
+		magazines[threadSlot.index] = m;
+	}
+	return m;
+}
+
+// returns the location of magazine slot i
+#ifdef PFN_POOL
+#define MAGAZINE_SLOT(m, i)		((m)->slots + (i) * pagesPerBlock)
+#else
+#define MAGAZINE_SLOT(m, i)		((m)->slots + (i) * blockSize)
+#endif
+
+// moves up to MAGAZINE_BATCH blocks from the top of the magazine's node stack; never grows the pool
+void StreamPool::RefillMagazine(Magazine* m) {
+	Syscall.EnterCS(cs);
+	NodePool& np  = nodes[m->node];
+	uint64_t pages = min((uint64_t)MAGAZINE_BATCH, np.tail / pagesPerBlock) * pagesPerBlock;
+	if (pages > 0) {
+		MoveRun(np, np.tail - pages, pages, MAGAZINE_SLOT(m, m->count), false);
+		np.tail           -= pages;
+		np.lowWater        = min(np.lowWater, np.tail);
+		freePages         -= pages;
+		minAvailableBlocks = min(minAvailableBlocks, (int64_t)freePages);
+		m->count          += pages / pagesPerBlock;
+	}
+	Syscall.LeaveCS(cs);
+}
+
+// pushes the top MAGAZINE_BATCH blocks of a full magazine back onto its node stack
+void StreamPool::SpillMagazine(Magazine* m) {
+	Syscall.EnterCS(cs);
+	NodePool& np  = nodes[m->node];
+	uint64_t pages = MAGAZINE_BATCH * pagesPerBlock;
+	m->count      -= MAGAZINE_BATCH;
+	MoveRun(np, np.tail, pages, MAGAZINE_SLOT(m, m->count), true);
+	np.tail       += pages;
+	freePages     += pages;
+	Syscall.LeaveCS(cs);
+}
+
+// private function - returns the top pages of a node's stack to the OS, requires mutex
+uint64_t StreamPool::ReleaseMemory(uint64_t node, uint64_t pages) {
+	// only whole blocks are released so that the stack stays block-aligned
+	NodePool& np = nodes[node];
+	pages        = RoundDown(min(pages, np.tail), pagesPerBlock);
+	if (pages == 0) return 0;
+
+#if defined(_WIN32)
+	Syscall.ReleasePages(StackSlot(np, np.tail - pages), pages, pageSize);
+#elif defined(VORTEX_MEMFD)
+	Syscall.ReleaseFilePages(poolFile, StackSlot(np, np.tail - pages), pages, pageSize);
+#else
+	// slabs are not adjacent in virtual memory; release one slab piece at a time
+	uint64_t position = np.tail - pages, remaining = pages;
+	while (remaining > 0) {
+		uint64_t count = min(remaining, slabPages - position % slabPages);
+		Syscall.ReleasePages(StackSlot(np, position), count, pageSize);
+		position  += count;
+		remaining -= count;
+	}
+#endif
+	np.tail      -= pages;
+	np.pageCount -= pages;
+	np.lowWater   = min(np.lowWater, np.tail);
+	pageCount    -= pages;
+	freePages    -= pages;
+	blockCount    = pageCount / pagesPerBlock;
+	return pages;
+}
+
+// returns every free page to the OS; blocks mapped in streams or cached in magazines are not affected
+uint64_t StreamPool::Trim(void) {
+	uint64_t released = 0;
+	Syscall.EnterCS(cs);
+	for (uint64_t i = 0; i < nodes.size(); i++) 
+		released += ReleaseMemory(i, nodes[i].tail);
+	Syscall.LeaveCS(cs);
+	memoryGovernor.Release(this, released * pageSize);
+	return released;
+}
+
+// reclaim entry for the memory governor: trims only if the pool is idle and returns the bytes released
+// without reporting them back, as the governor holds its own lock
+uint64_t StreamPool::TryTrim(void) {
+	if (!Syscall.TryEnterCS(cs)) return 0;
+	uint64_t released = 0;
+	for (uint64_t i = 0; i < nodes.size(); i++) 
+		released += ReleaseMemory(i, nodes[i].tail);
+	Syscall.LeaveCS(cs);
+	return released * pageSize;
+}
+
+// releases, every period, the pages that stayed free for the whole period; zero disables trimming
+void StreamPool::SetIdleTrim(uint64_t milliseconds) {
+	// stop the current trimmer, if any
+	if (trimThread != nullptr) {
+		Syscall.RaiseEvent(trimStop);
+		trimThread->join();
+		delete trimThread;
+		Syscall.DeleteEvent(trimStop);
+		trimThread = nullptr;
+	}
+
+	trimPeriod = milliseconds;
+	if (trimPeriod == 0) return;
+
+	// the first period starts now
+	Reset();
+	Syscall.MakeEvent(trimStop, NULL);
+	trimThread = new thread(&StreamPool::IdleTrimLoop, this);
+}
+
+// idle trimmer; the low-water mark of each node tells how many of its pages went unused
+void StreamPool::IdleTrimLoop(void) {
+	while (!Syscall.TimedWaitEvent(trimStop, trimPeriod)) {
+		uint64_t released = 0;
+		Syscall.EnterCS(cs);
+		for (uint64_t i = 0; i < nodes.size(); i++) {
+			released         += ReleaseMemory(i, nodes[i].lowWater);
+			nodes[i].lowWater = nodes[i].tail;
+		}
+		Syscall.LeaveCS(cs);
+		memoryGovernor.Release(this, released * pageSize);
+	}
 }
 
 // return StreamPool resources to the OS
 StreamPool::~StreamPool() {
-	Syscall.FreePages(PFN, pageCount, pageSize);
+	SetIdleTrim(0);
+	memoryGovernor.Unregister(this);
+	for (uint64_t i = 0; i < MAX_MAGAZINES; i++) {
+		Magazine* m = magazines[i];
+		if (m == NULL) continue;
+#if defined(_WIN32)
+		if (m->count > 0) Syscall.FreePages(m->slots, m->count * pagesPerBlock, pageSize);
+		else              free(m->slots);
+#elif defined(VORTEX_MEMFD)
+		free(m->slots);
+#else
+		Syscall.FreePages(m->slots, MAGAZINE_BLOCKS * pagesPerBlock, pageSize);
+#endif
+		delete m;
+	}
+	for (uint64_t i = 0; i < nodes.size(); i++) {
+#if defined(_WIN32)
+		if (nodes[i].pageCount > 0) Syscall.FreePages(nodes[i].PFN, nodes[i].pageCount, pageSize);
+		else                        free(nodes[i].PFN);
+#elif defined(VORTEX_MEMFD)
+		free(nodes[i].PFN);
+#else
+		for (uint64_t j = 0; j < nodes[i].slabs.size(); j++) 
+			Syscall.FreePages(nodes[i].slabs[j], slabPages, pageSize);
+#endif
+	}
+#ifdef VORTEX_MEMFD
+	Syscall.ClosePoolFile(poolFile);
+#endif
 	Syscall.DeleteCS(cs);
 }
 
+// sets the number of page colors for streams allocated from now on; rounded up to a power of two
+void StreamPool::SetColors(uint64_t count) {
+	colors = 1;
+	while (colors < count) colors <<= 1;
+}
+
 // resets the record of the minimum pages on the stack
 void StreamPool::Reset(void) {
+	Syscall.EnterCS(cs);
 	minAvailableBlocks = INT64_MAX;
+	for (uint64_t i = 0; i < nodes.size(); i++) 
+		nodes[i].lowWater = nodes[i].tail;
+	Syscall.LeaveCS(cs);
 }
 
-// pushes numPages page frame numbers onto the PFN stack
-void StreamPool::ReturnFreeBlock(uint64_t numPages, BlockType* pagePtr) {
+// pushes numPages page frame numbers onto the PFN stack of the node they were taken from
+void StreamPool::ReturnFreeBlock(uint64_t numPages, BlockType* pagePtr, uint64_t node) {
+	// whole blocks of the magazine's node are cached by the calling thread
+	Magazine* m = numPages == pagesPerBlock ? LocalMagazine() : NULL;
+	if (m != NULL && m->node == node) {
+		if (m->count == MAGAZINE_BLOCKS) SpillMagazine(m);
+#ifdef PFN_POOL
+		memcpy(MAGAZINE_SLOT(m, m->count), pagePtr, numPages * sizeof(BlockType));
+#else
+		mremap(pagePtr, blockSize, blockSize, MREMAP_MAYMOVE | MREMAP_FIXED, MAGAZINE_SLOT(m, m->count));
+#endif
+		m->count++;
+		return;
+	}
+
 	// assure that no other threads push/pop/adjust memory
 	Syscall.EnterCS(cs);
+	NodePool& np = nodes[node];
 
-#ifdef _WIN32
 	// stash the pages from the block; Push()
-	memcpy(PFN + tail, pagePtr, numPages * sizeof(BlockType));
-#else
-	// map the pages back to the VM space; Push()
-	mremap(pagePtr, numPages * pageSize, numPages * pageSize, MREMAP_MAYMOVE | MREMAP_FIXED, PFN + tail * pageSize);
-#endif
-	tail += numPages;
+	MoveRun(np, np.tail, numPages, pagePtr, true);
+	np.tail   += numPages;
+	freePages += numPages;
 
 	// yield to other threads
 	Syscall.LeaveCS(cs);
 }
 
-// pops numPages page frame numbers from the PFN stack
-BlockType* StreamPool::GetNewBlock(uint64_t numPages, BlockType* pagePtr) {
+// pops numPages page frame numbers from the PFN stack of the caller's node, reporting the node used
+BlockType* StreamPool::GetNewBlock(uint64_t numPages, BlockType* pagePtr, uint64_t& node) {
+	// whole blocks come from the calling thread's magazine whenever it can be refilled
+	Magazine* m = numPages == pagesPerBlock ? LocalMagazine() : NULL;
+	if (m != NULL) {
+		if (m->count == 0) RefillMagazine(m);
+		if (m->count > 0) {
+			m->count--;
+			node = m->node;
+#ifdef PFN_POOL
+			memcpy(pagePtr, MAGAZINE_SLOT(m, m->count), numPages * sizeof(BlockType));
+			return pagePtr;
+#else
+			return MAGAZINE_SLOT(m, m->count);
+#endif
+		}
+	}
+	uint64_t local = Syscall.GetCurrentNode() % nodes.size();
+
 	// assure that no other threads push/pop/adjust memory
 	Syscall.EnterCS(cs);
 
-	// if the pool is too empty, replenish it by allocating an extra block
-	if (tail < numPages) 
-		ExpandPhysicalMemory(pageCount + numPages - tail);
+	// if no node has enough pages, replenish the local one by allocating an extra block
+	node = SelectNode(local, numPages);
+	NodePool& np = nodes[node];
+	while (np.tail < numPages) {
+		uint64_t extraPageCount = numPages - np.tail;
+#ifndef PFN_POOL
+		// slabs are carved into whole blocks so that no block straddles two slabs
+		extraPageCount = RoundUp(extraPageCount, pagesPerBlock);
+#endif
+		if (!ChargeGovernor(extraPageCount))
+			ReportError("memory budget exhausted; %llu bytes held of %llu\n", memoryGovernor.GetUsed(), memoryGovernor.GetBudget());
+		if (np.tail < numPages) ExpandPhysicalMemory(node, extraPageCount);
+		else                    memoryGovernor.Release(this, extraPageCount * pageSize);
+	}
 
-#ifdef _WIN32
+#ifdef PFN_POOL
 	// grab the pages from the stack; Pop()
-	memcpy(pagePtr, PFN + tail - numPages, numPages * sizeof(BlockType));
+	memcpy(pagePtr, StackSlot(np, np.tail - numPages), numPages * sizeof(BlockType));
 #else
-	pagePtr = (char*) PFN + (tail - numPages) * pageSize;
+	pagePtr = StackSlot(np, np.tail - numPages);
 #endif
-	tail              -= numPages;
-	minAvailableBlocks = min(tail, pageCount);
+	np.tail           -= numPages;
+	np.lowWater        = min(np.lowWater, np.tail);
+	freePages         -= numPages;
+	minAvailableBlocks = min(minAvailableBlocks, (int64_t)freePages);
 
 	// yield to other threads
 	Syscall.LeaveCS(cs);
@@ -146,13 +471,17 @@ void StreamPool::MapBlock(BufferConfig *bc, char* blockAddress, uint64_t numPage
 	}
 #endif
 	// map the block
+#ifdef VORTEX_MEMFD
+	Syscall.MapFilePages(blockAddress, numPages, pageSize, poolFile, pages);
+#else
 	Syscall.MapPages(blockAddress, numPages, pageSize, pages);
+#endif
 }
 
 // unmaps a physical block from virtual memory
 void StreamPool::UnmapBlock(BufferConfig* bc, char* blockAddress, uint64_t pages) {
 	// unmap the block
-	Syscall.UnmapPages(blockAddress, pages);
+	Syscall.UnmapPages(blockAddress, pages, pageSize);
 #ifdef _WIN32
 	// we want to keep chunk 0 in-place
 	uint64_t chunk      = (blockAddress - bc->bufMain) / bc->chunkSize;
@@ -185,14 +514,14 @@ void StreamPool::InitializePool(void) {
 	pageSize      = 1LLU << pageSizePower;
 	blockSize     = RoundUp(1LLU << blockSizePower, pageSize);
 	pagesPerBlock = blockSize / pageSize;
+	slabPages     = RoundUp(SLAB_SIZE, blockSize) / pageSize;
 }
 
-#define MAX_COLORS		1024
 // allocates the virtual memory and physical pages for blocks for Vortex
 void StreamPool::BufferAlloc(uint64_t memoryRequired, uint64_t chunkSize, uint64_t color, BufferConfig* bc) {
 	// must round up the memory *before* adding stagger
 	uint64_t alignedMemoryRequired = RoundUp(memoryRequired + pageSize, blockSize);
-	bc->reserveSize                = alignedMemoryRequired + pageSize * MAX_COLORS;
+	bc->reserveSize                = alignedMemoryRequired + pageSize * colors;
 
 #ifdef _WIN32
 	// make sure chunks are no larger than total space
@@ -236,13 +565,13 @@ void StreamPool::BufferAlloc(uint64_t memoryRequired, uint64_t chunkSize, uint64
 	Syscall.LeaveCS(cs);
 
 	// aim to have page color equal to the one requested by the user
-	int kernelColor = ((uint64_t)bc->bufMain >> 12) & (MAX_COLORS - 1);
+	int kernelColor = ((uint64_t)bc->bufMain >> 12) & (colors - 1);
 
 	// correct pages for stepped first block size (e.g., 256, 255, 254,...,1)
 	if (color == 0) colorShift = kernelColor;
 
-	// coloring is needed for bucket sort on Sandy/Ivy Bridge with the 8+8+8 pattern
-	bc->buf = bc->bufMain + ((color + colorShift - kernelColor) & (MAX_COLORS - 1)) * pageSize;
+	// coloring keeps the bucket heads of the sort from competing for the same cache sets
+	bc->buf = bc->bufMain + ((color + colorShift - kernelColor) & (colors - 1)) * pageSize;
 }
 
 
@@ -19,12 +19,65 @@
 #pragma once
 #include "SystemFunctions.h"
 
+// stream stagger used when the cache geometry is unknown; tuned for the 8+8+8 sort on Sandy/Ivy Bridge
+#define DEFAULT_COLORS	1024
+
+// fixed virtual size of one Linux pool slab; only committed pages are backed by memory
+#define SLAB_SIZE		(1LLU << 30)
+
+// per-thread block caches; a thread refills/spills its magazine MAGAZINE_BATCH blocks at a time
+#define MAGAZINE_BLOCKS		8
+#define MAGAZINE_BATCH		(MAGAZINE_BLOCKS / 2)
+#define MAX_MAGAZINES		64			// threads beyond this go straight to the node stacks
+
+// free blocks cached by one thread; only its owner touches it, so no lock is needed
+class Magazine {
+public:
+	uint64_t   node;		// node all cached blocks belong to
+	uint64_t   count;		// number of cached blocks
+	BlockType* slots;		// PFN pools: PFNs of MAGAZINE_BLOCKS blocks; otherwise virtual space for MAGAZINE_BLOCKS blocks
+};
+
+// page stack holding the physical memory of one NUMA node
+class NodePool {
+public:
+	BlockType*         PFN       = nullptr;		// PFN pools: page frame array
+	vector<BlockType*> slabs;					// mremap-based Linux: fixed-size slabs holding the stack pages
+	uint64_t           pageCount = 0;
+	uint64_t           tail      = 0;
+	uint64_t           lowWater  = 0;				// lowest tail since the last Reset()/trim
+};
+
 class StreamPool {
-	BlockType* PFN;
+	vector<NodePool> nodes;
 	uint64_t   pageCount;
-	uint64_t   tail;
+	uint64_t   freePages;
 	uint64_t   colorShift;
-	void	   ExpandPhysicalMemory(uint64_t totalPageCount);
+	uint64_t   colors;			// page colors used to stagger streams; a power of two
+	bool       prefault;		// commit pages when the pool grows rather than on their first use
+	uint64_t   slabPages;
+#ifdef VORTEX_MEMFD
+	int        poolFile;		// memfd holding every page of the pool
+	uint64_t   filePages;		// pages the file has been grown to; released pages leave holes
+#endif
+	void	   ExpandPhysicalMemory(uint64_t node, uint64_t extraPageCount);
+	bool	   ChargeGovernor(uint64_t pages);
+	BlockType* StackSlot(NodePool& np, uint64_t position);
+	uint64_t   SelectNode(uint64_t local, uint64_t numPages);
+	uint64_t   ReleaseMemory(uint64_t node, uint64_t pages);
+	void	   MoveRun(NodePool& np, uint64_t position, uint64_t pages, BlockType* other, bool toStack);
+
+	// per-thread magazines, indexed by the thread's slot
+	Magazine*  magazines[MAX_MAGAZINES];
+	Magazine*  LocalMagazine(void);
+	void	   RefillMagazine(Magazine* m);
+	void	   SpillMagazine(Magazine* m);
+
+	// idle trimming
+	thread*    trimThread;
+	EventType  trimStop;
+	uint64_t   trimPeriod;
+	void	   IdleTrimLoop(void);
 public:
 	CSType*    cs;
 	uint64_t   blockSize, pagesPerBlock, pageSize;
@@ -35,12 +88,19 @@ public:
 	StreamPool(uint64_t blockSizePower);
 	~StreamPool();
 
-	void	   AdjustPoolPhysicalMemory(uint64_t totalPageCount);
+	bool	   AdjustPoolPhysicalMemory(uint64_t totalPageCount);
 	void	   Reset(void);
+	uint64_t   Trim(void);
+	uint64_t   TryTrim(void);
+	void	   SetIdleTrim(uint64_t milliseconds);
+	void	   SetColors(uint64_t count);
+	void	   SetPrefault(bool enable) { prefault = enable; }
+	uint64_t   GetColors(void) { return colors; }
 
-	uint64_t   CountFreeBlocks() { return tail; }
-	BlockType* GetNewBlock(uint64_t pages, BlockType* pagePtr);
-	void	   ReturnFreeBlock(uint64_t pages, BlockType* pagePtr);
+	uint64_t   CountFreeBlocks() { return freePages; }
+	uint64_t   NodeCount() { return nodes.size(); }
+	BlockType* GetNewBlock(uint64_t pages, BlockType* pagePtr, uint64_t& node);
+	void	   ReturnFreeBlock(uint64_t pages, BlockType* pagePtr, uint64_t node);
 
 	void	   MapBlock(BufferConfig *bc, char* virtualPtr, uint64_t numPages, BlockType* PFN);
 	void	   UnmapBlock(BufferConfig* bc, char* blockAddress, uint64_t pages);
@@ -41,6 +41,18 @@ void  sys::WaitSemaphore(SemaType* sem) {
 #endif
 }
 
+// takes the given semaphore only if it is available without waiting
+bool  sys::TryWaitSemaphore(SemaType* sem) {
+#ifdef _WIN32
+	DWORD res = WaitForSingleObject(*sem, 0);
+	if (res == WAIT_FAILED)
+		ReportError("WaitForSingleObject TryWait error %d\n", GetLastError());
+	return res == WAIT_OBJECT_0;
+#else
+	return sem_trywait(sem) == 0;
+#endif
+}
+
 // increments the given semaphore's interal counter
 void  sys::FreeSemaphore(SemaType* sem, uint64_t count) {
 #ifdef _WIN32
@@ -108,20 +120,21 @@ bool  sys::TimedWaitEvent(EventType& ev, uint64_t times) {
 	return wait == WAIT_OBJECT_0;
 #else
 	struct timespec ts;
-	struct timeval now;
-
-	gettimeofday(&now, NULL);
+	clock_gettime(CLOCK_REALTIME, &ts);
 
-	ts.tv_sec = time(NULL) + times / (uint64_t)1e3;
-	ts.tv_nsec = now.tv_usec * (uint64_t)1e9 * (times % (uint64_t)1e3);
-	ts.tv_sec += ts.tv_nsec / (uint64_t)1e9;
+	// absolute deadline, times is in milliseconds
+	ts.tv_sec  += times / (uint64_t)1e3;
+	ts.tv_nsec += (times % (uint64_t)1e3) * (uint64_t)1e6;
+	ts.tv_sec  += ts.tv_nsec / (uint64_t)1e9;
 	ts.tv_nsec %= (uint64_t)1e9;
 
 	pthread_mutex_lock(ev.mutex);
-	pthread_cond_timedwait(ev.cond, ev.mutex, &ts);
+	while (!ev.signalled) 
+		if (pthread_cond_timedwait(ev.cond, ev.mutex, &ts) == ETIMEDOUT) break;
+	bool signalled = ev.signalled;
 	pthread_mutex_unlock(ev.mutex);
 
-	return ev.signalled;
+	return signalled;
 #endif
 }
 
@@ -156,6 +169,15 @@ void sys::EnterCS(CSType* cs) {
 #endif
 }
 
+// locks the given critical section only if it is free
+bool sys::TryEnterCS(CSType* cs) {
+#ifdef _WIN32
+	return TryEnterCriticalSection(cs) != 0;
+#else
+	return pthread_mutex_trylock(cs) == 0;
+#endif
+}
+
 // unlocks the given critical section
 void sys::LeaveCS(CSType* cs) {
 #ifdef _WIN32
@@ -195,6 +217,21 @@ void sys::SleepCV(CVType* cv, CSType* cs) {
 #endif
 }
 
+// sleeps on the given condition variable for at most time milliseconds; false on timeout
+bool sys::TimedSleepCV(CVType* cv, CSType* cs, uint64_t time) {
+#ifdef _WIN32
+	return SleepConditionVariableCS(cv, cs, (DWORD)time) != 0;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec  += time / (uint64_t)1e3;
+	ts.tv_nsec += (time % (uint64_t)1e3) * (uint64_t)1e6;
+	ts.tv_sec  += ts.tv_nsec / (uint64_t)1e9;
+	ts.tv_nsec %= (uint64_t)1e9;
+	return pthread_cond_timedwait(cv, cs, &ts) != ETIMEDOUT;
+#endif
+}
+
 // wakes the given condition variable
 void sys::WakeCV(CVType* cv) {
 #ifdef _WIN32
@@ -204,6 +241,15 @@ void sys::WakeCV(CVType* cv) {
 #endif
 }
 
+// wakes every thread sleeping on the given condition variable
+void sys::WakeAllCV(CVType* cv) {
+#ifdef _WIN32
+	WakeAllConditionVariable(cv);
+#else
+	pthread_cond_broadcast(cv);
+#endif
+}
+
 // deletes the given condition variable
 void sys::DeleteCV(CVType* cv) {
 #ifdef _WIN32
@@ -233,11 +279,15 @@ void sys::MapPages(char* dest, uint64_t pages, uint64_t pageSize, void* page) {
 #pragma warning( pop ) 
 #endif
 
-// unmaps the given pages - null in Linux as you cannot both 1) unmap, and 2) retain the PFNs
-void sys::UnmapPages(void* page, uint64_t pages) {
+// unmaps the given pages - null in mremap-based Linux as you cannot both 1) unmap, and 2) retain the PFNs
+void sys::UnmapPages(void* page, uint64_t pages, uint64_t pageSize) {
 #ifdef _WIN32
 	if (!MapUserPhysicalPages(page, pages, NULL))
 		ReportError("unmapping block failed with %d\n", GetLastError());
+#elif defined(VORTEX_MEMFD)
+	// replace the file mapping with an inaccessible reservation, so the next touch faults again
+	void* re = mmap(page, pages * pageSize, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, -1, 0);
+	if (re == MAP_FAILED) ReportError("unmapping block at %p failed with %d\n", page, errno);
 #endif
 }
 
@@ -291,47 +341,45 @@ void* sys::AllocateVirtual(char* start, uint64_t size, int flag) {
 	return (void*)temp;
 }
 
-// allocates physical pages for virtual memory mapping
+// returns physical pages to the OS; the virtual range stays reserved so that it can be committed again
 #ifdef _WIN32
 #pragma warning( push )
 #pragma warning( disable : 4100)
-void  sys::AllocatePages(uint64_t pageCount, uint64_t pageSize, BlockType* start) {
+#endif
+void sys::ReleasePages(BlockType* start, uint64_t pageCount, uint64_t pageSize) {
+#ifdef _WIN32
+	if (!FreeUserPhysicalPages(GetCurrentProcess(), &pageCount, start))
+		ReportError("FreeUserPhysicalPages with %d\n", GetLastError());
 #else
-void* sys::AllocatePages(BlockType* start, uint64_t pagesPresent, uint64_t pagesNeeded, uint64_t pageSize, BlockType* end) {
+	void* re = mmap(start, pageSize * pageCount, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, -1, 0);
+	if (re == MAP_FAILED) ReportError("Could not release %llu pages, error %d\n", pageCount, errno);
+#endif
+}
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+// allocates physical pages for virtual memory mapping; without populate, Linux commits them on first touch
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable : 4100)
 #endif
+void sys::AllocatePages(uint64_t pageCount, uint64_t pageSize, BlockType* start, uint64_t node, bool populate) {
 #ifdef _WIN32
 	auto intendedPages = pageCount;
-	if (!AllocateUserPhysicalPages(GetCurrentProcess(), &intendedPages, start))
-		ReportError("AllocateUserPhysicalPages with %d\n", GetLastError());
+	if (!AllocateUserPhysicalPagesNuma(GetCurrentProcess(), &intendedPages, start, (DWORD)node))
+		ReportError("AllocateUserPhysicalPagesNuma with %d\n", GetLastError());
 
 	if (intendedPages != pageCount) 
 		ReportError("Not enough memory for AllocateUserPhysicalPages\n");
 #else
-	if (start == nullptr) {
-		start = (char*)mmap(0, pageSize * pagesNeeded, PROT_WRITE | PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-		if (start == MAP_FAILED) ReportError("Could not mmap");
-		memset(start, 0, pageSize * pagesNeeded);
-	}
-	else {
-		// create the mapping
-		uint64_t newSize = pageSize * pagesNeeded + (end - start);
-		BlockType* newPFN = (BlockType*)mmap(0, newSize,
-			PROT_WRITE | PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-
-		// fetch new pages from the OS
-		memset(newPFN + (end - start), 0, pagesNeeded * pageSize);
-
-		// map old pages onto the new location
-		mremap(start, (end - start), (end - start),
-			MREMAP_MAYMOVE | MREMAP_FIXED, newPFN);
-
-		// map new pages after old pages
-		char* dest = newPFN + (pagesPresent * pageSize);
-		mremap(newPFN + (end - start), pagesNeeded * pageSize, pagesNeeded * pageSize, 
-			MREMAP_MAYMOVE | MREMAP_FIXED, (char*)dest);
-		start = newPFN;
-	}
-	return start;
+	// commit the range in place; only the new pages are touched, regardless of pool size
+	void* re = mmap(start, pageSize * pageCount, PROT_WRITE | PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED, -1, 0);
+	if (re == MAP_FAILED) ReportError("Could not mmap %llu pages, error %d\n", pageCount, errno);
+
+	// fetch new pages from the OS on the requested node
+	BindToNode(start, pageSize * pageCount, node);
+	if (populate) PrefaultPages(start, pageSize * pageCount);
 #endif
 }
 #ifdef _WIN32
@@ -400,6 +448,88 @@ void sys::FreePages(void* ptr, uint64_t pageCount, uint64_t pageSize) {
 #pragma warning( pop )
 #endif
 
+#ifdef __linux__
+// commits one slice of a pre-fault; the kernel hands out zeroed pages, so user-space zeroing is only a fallback
+static void PopulateSlice(char* start, uint64_t size) {
+	if (madvise(start, size, MADV_POPULATE_WRITE) != 0) memset(start, 0, size);
+}
+#endif
+
+// commits the pages of a writable range, one worker per core for large ranges; Windows pages are resident
+// as soon as they are allocated
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable : 4100)
+#endif
+void sys::PrefaultPages(void* start, uint64_t size) {
+#ifdef __linux__
+	uint64_t workers = min((uint64_t)thread::hardware_concurrency(), size / PREFAULT_SLICE);
+	if (workers <= 1) {
+		PopulateSlice((char*)start, size);
+		return;
+	}
+
+	uint64_t       slice = RoundUp(size / workers, 4096);
+	vector<thread> pool;
+	for (uint64_t offset = 0; offset < size; offset += slice) 
+		pool.push_back(thread(PopulateSlice, (char*)start + offset, min(slice, size - offset)));
+	for (uint64_t i = 0; i < pool.size(); i++) pool[i].join();
+#endif
+}
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#ifdef VORTEX_MEMFD
+// creates the anonymous file that holds the physical pages of a pool
+int sys::CreatePoolFile(void) {
+	int file = memfd_create("vortex-pool", MFD_CLOEXEC);
+	if (file < 0) ReportError("memfd_create failed with %d\n", errno);
+	return file;
+}
+
+// closes a pool file; its pages are freed once no mapping refers to them
+void sys::ClosePoolFile(int file) {
+	close(file);
+}
+
+// grows the pool file by pageCount pages starting at firstPage and records their page numbers; populate commits
+// them with fallocate(), which defers zeroing to their first mapping; otherwise that mapping commits them
+void sys::AllocateFilePages(int file, uint64_t firstPage, uint64_t pageCount, uint64_t pageSize, BlockType* PFN, uint64_t node, bool populate) {
+	if (ftruncate(file, (firstPage + pageCount) * pageSize) != 0) 
+		ReportError("Could not grow the pool file to %llu pages, error %d\n", firstPage + pageCount, errno);
+
+	// fetch the new pages from the OS on the requested node through a temporary window
+	void* window = mmap(NULL, pageCount * pageSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, firstPage * pageSize);
+	if (window == MAP_FAILED) ReportError("Could not mmap %llu pool pages, error %d\n", pageCount, errno);
+	BindToNode(window, pageCount * pageSize, node);
+	if (populate && fallocate(file, 0, firstPage * pageSize, pageCount * pageSize) != 0) 
+		PrefaultPages(window, pageCount * pageSize);
+	munmap(window, pageCount * pageSize);
+
+	for (uint64_t i = 0; i < pageCount; i++) PFN[i] = firstPage + i;
+}
+
+// punches the given pages out of the pool file, one run of consecutive page numbers at a time
+void sys::ReleaseFilePages(int file, BlockType* PFN, uint64_t pageCount, uint64_t pageSize) {
+	for (uint64_t i = 0, run; i < pageCount; i += run) {
+		for (run = 1; i + run < pageCount && PFN[i + run] == PFN[i] + run; run++);
+		if (fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, PFN[i] * pageSize, run * pageSize) != 0)
+			ReportError("Could not release %llu pool pages, error %d\n", run, errno);
+	}
+}
+
+// maps the given pool pages at dest, one run of consecutive page numbers at a time
+void sys::MapFilePages(char* dest, uint64_t pages, uint64_t pageSize, int file, BlockType* PFN) {
+	for (uint64_t i = 0, run; i < pages; i += run) {
+		for (run = 1; i + run < pages && PFN[i + run] == PFN[i] + run; run++);
+		void* re = mmap(dest + i * pageSize, run * pageSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | MAP_POPULATE, 
+			file, PFN[i] * pageSize);
+		if (re == MAP_FAILED) ReportError("Error on mmap at %p of pool page %llu error %d\n", dest + i * pageSize, PFN[i], errno);
+	}
+}
+#endif
+
 void* sys::StartTimer() {
 	TimeType* clock = new TimeType();
 #ifdef _WIN32
@@ -452,6 +582,65 @@ void sys::SetAffinity(uint64_t threadID) {
 #endif
 }
 
+// returns the number of NUMA nodes (highest node number + 1)
+uint64_t sys::NodeCount(void) {
+#ifdef _WIN32
+	ULONG highest;
+	if (!GetNumaHighestNodeNumber(&highest)) return 1;
+	return (uint64_t)highest + 1;
+#else
+	// the kernel reports possible nodes as a range list, e.g., "0" or "0-1"
+	uint64_t highest = 0;
+	FILE* f = fopen("/sys/devices/system/node/possible", "r");
+	if (f == NULL) return 1;
+	char line[256];
+	if (fgets(line, sizeof(line), f) != NULL) {
+		char* p = line;
+		while (*p) {
+			if (*p >= '0' && *p <= '9') highest = max(highest, (uint64_t)strtoull(p, &p, 10));
+			else p++;
+		}
+	}
+	fclose(f);
+	return highest + 1;
+#endif
+}
+
+// returns the NUMA node of the CPU the calling thread is running on
+uint64_t sys::GetCurrentNode(void) {
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor;
+	USHORT node;
+	GetCurrentProcessorNumberEx(&processor);
+	if (!GetNumaProcessorNodeEx(&processor, &node)) return 0;
+	return node;
+#else
+	unsigned cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return 0;
+	return node;
+#endif
+}
+
+// prefers the given NUMA node for pages that are subsequently faulted in the range
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable : 4100)
+#endif
+void sys::BindToNode(void* ptr, uint64_t size, uint64_t node) {
+#ifdef __linux__
+	// single-node machines need no policy
+	if (NodeCount() < 2) return;
+	unsigned long mask[16] = { 0 };
+	if (node >= sizeof(mask) * 8) return;
+	mask[node / 64] = 1LU << (node % 64);
+	if (syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0) != 0)
+		PRINT("mbind to node %llu failed with %d\n", node, errno);
+#endif
+}
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
 // counts the number of MSD zeroes using builtin functions
 int sys::BitScan(uint64_t size) {
 #ifdef _WIN32
@@ -471,4 +660,13 @@ void sys::cpuid(CpuidType* result, int info) {
 #else
 	__get_cpuid(info, result, result + 1, result + 2, result + 3);
 #endif
+}
+
+// cpuid with a sub-leaf in ecx (e.g., the cache index of leaf 4)
+void sys::cpuidex(CpuidType* result, int info, int subinfo) {
+#ifdef _WIN32
+	__cpuidex(result, info, subinfo);
+#else
+	__cpuid_count(info, subinfo, result[0], result[1], result[2], result[3]);
+#endif
 }
\ No newline at end of file
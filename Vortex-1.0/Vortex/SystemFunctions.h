@@ -51,6 +51,7 @@ typedef int                CpuidType;
 #include <math.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include <sys/syscall.h>
 #include <algorithm>
 #include <unistd.h>
 // custom linux event
@@ -64,7 +65,12 @@ struct TimeType {
 	struct timespec start;
 	struct timespec last;
 };
+#ifdef VORTEX_MEMFD
+#include <fcntl.h>
+typedef uint64_t        BlockType;		// page number within the pool's memfd
+#else
 typedef char            BlockType;
+#endif
 typedef pthread_mutex_t CSType;
 typedef pthread_cond_t  CVType;
 typedef sem_t           SemaType;
@@ -86,6 +92,23 @@ typedef uint            CpuidType;
 // NOTE: not applicable to Linux - just for code compatability
 #define MEM_RESERVE  0
 #define MEM_PHYSICAL 1
+
+// NUMA memory policy for mbind(); avoids a dependency on libnuma
+#define MPOL_PREFERRED 1
+
+// commits pages without touching them from user space; Linux 5.14+, older kernels fall back to memset
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
+// smallest share of a pre-fault handed to one worker thread
+#define PREFAULT_SLICE ((uint64_t)64 << 20)
+
+#if defined(_WIN32) || defined(VORTEX_MEMFD)
+// blocks are arrays of page frame numbers (physical pages on Windows, memfd pages on Linux) rather than
+// pages that travel with their current virtual address
+#define PFN_POOL
 #endif
 
 // hybrid system functions for Windows/Linux
@@ -97,6 +120,7 @@ public:
 	// semaphore interactions
 	void*  MakeSemaphore(uint64_t init, uint64_t max);
 	void   WaitSemaphore(SemaType* sem);
+	bool   TryWaitSemaphore(SemaType* sem);
 	void   FreeSemaphore(SemaType* sem, uint64_t count);
 
 	// event interactions
@@ -110,18 +134,21 @@ public:
 	// critical section interactions
 	void*  MakeCS();
 	void   EnterCS(CSType* cs);
+	bool   TryEnterCS(CSType* cs);
 	void   LeaveCS(CSType* cs);
 	void   DeleteCS(CSType* ev);
 
 	// condition Variable interactions
 	void*  MakeCV();
 	void   SleepCV(CVType* cv, CSType* cs);
+	bool   TimedSleepCV(CVType* cv, CSType* cs, uint64_t time);
 	void   WakeCV(CVType* cv);
+	void   WakeAllCV(CVType* cv);
 	void   DeleteCV(CVType* cv);
 
 	// page mapping
 	void   MapPages(char* dest, uint64_t pages, uint64_t pageSize, void* page);
-	void   UnmapPages(void* page, uint64_t size);
+	void   UnmapPages(void* page, uint64_t pages, uint64_t pageSize);
 
 	//  static memory allocation
 	void*  AllocateStatic(uint64_t size);
@@ -131,13 +158,20 @@ public:
 	void*  AllocateVirtual(char* start, uint64_t size, int flag);
 	void   FreeVirtual(void* ptr, uint64_t size);
 
-	// physical page allocation - pages handled differently between OSes
-#ifdef _WIN32
-	void   AllocatePages(uint64_t pageCount, uint64_t pageSize, BlockType* start);
-#else
-	void*  AllocatePages(BlockType* start, uint64_t pagesPresent, uint64_t pagesNeeded, uint64_t pageSize, BlockType* end);
-#endif
+	// physical page allocation - Windows fills a PFN array, Linux commits pages at the given address
+	void   AllocatePages(uint64_t pageCount, uint64_t pageSize, BlockType* start, uint64_t node, bool populate);
+	void   ReleasePages(BlockType* start, uint64_t pageCount, uint64_t pageSize);
 	void   FreePages(void* ptr, uint64_t pageCount, uint64_t blockSize);
+	void   PrefaultPages(void* start, uint64_t size);
+
+#ifdef VORTEX_MEMFD
+	// memfd-backed pages; PFNs are page numbers within the file
+	int    CreatePoolFile(void);
+	void   ClosePoolFile(int file);
+	void   AllocateFilePages(int file, uint64_t firstPage, uint64_t pageCount, uint64_t pageSize, BlockType* PFN, uint64_t node, bool populate);
+	void   ReleaseFilePages(int file, BlockType* PFN, uint64_t pageCount, uint64_t pageSize);
+	void   MapFilePages(char* dest, uint64_t pages, uint64_t pageSize, int file, BlockType* PFN);
+#endif
 
 	// aligned memory allocation
 	void*  AllocAligned(uint64_t size, uint64_t alignment);
@@ -155,11 +189,17 @@ public:
 	// affinity mask
 	void   SetAffinity(uint64_t thread);
 
+	// NUMA topology
+	uint64_t NodeCount(void);
+	uint64_t GetCurrentNode(void);
+	void     BindToNode(void* ptr, uint64_t size, uint64_t node);
+
 	// bit scan
 	int    BitScan(uint64_t size);
 
 	// cpuid
 	void   cpuid(CpuidType* result, int info);
+	void   cpuidex(CpuidType* result, int info, int subinfo);
 };
 
 // globally available system functions
@@ -44,6 +44,11 @@ VortexC::VortexC(uint64_t size, uint64_t blockSizePower, uint64_t comeBackConsum
 	writeBuf = bcWriter->bufMain;
 	lastWriterPosition = 0;
 
+	// fault-around holds blocks back from the consumer, so leave it at least half of the window
+	releasedBlocks = mappedBlocks = 0;
+	faultAround    = 1;
+	SetFaultAround(fwd / 2);
+
 	// add the streams to the handler
 	streamManager.AddStream(bcReader->bufMain, bcReader->bufMain + bcReader->reserveSize, this);
 	streamManager.AddStream(bcWriter->bufMain, bcWriter->bufMain + bcWriter->reserveSize, this);
@@ -81,24 +86,48 @@ void VortexC::HandleWriteFault(char* faultAddress, char* alignedFaultAddress) {
 
 	lastWriterPosition = faultAddress;
 	// added for PFN-based mapping
-	uint64_t pagesNeeded, pageSpacing = (faultAddress - writeBuf) >> sp->pageSizePower;
+	uint64_t pagesNeeded;
+#ifdef PFN_POOL
+	uint64_t pageSpacing = (faultAddress - writeBuf) >> sp->pageSizePower;
 	if (index != 0)       pagesNeeded = sp->pagesPerBlock;
 	else                  pagesNeeded = sp->pagesPerBlock - (pageSpacing & (sp->pagesPerBlock - 1));
+#else
+	// mremap-based Linux requires blockSize aligned memory mappings
+	pagesNeeded = sp->pagesPerBlock;
+#endif
 
-	// release the next full block
-	int64_t writerReleaseOffset = index - (comeBackProducer + 1);
-	if (writerReleaseOffset >= 0) 
-		Syscall.FreeSemaphore(semFull, 1);
+	// release every full block more than L behind the fault
+	int64_t writerReleaseOffset = index - comeBackProducer;
+	if (writerReleaseOffset > (int64_t)releasedBlocks) {
+		Syscall.FreeSemaphore(semFull, writerReleaseOffset - releasedBlocks);
+		releasedBlocks = writerReleaseOffset;
+	}
+
+	// a fault right past the mapped blocks means sequential writing; grow the fault-around
+	if (index == mappedBlocks && index != 0) faultAround = min(faultAround * 2, maxFaultAround);
+	else                                     faultAround = 1;
 	
 	// wait for the next empty block
 	Syscall.WaitSemaphore(semEmpty);
+	MapWriterBlock(index, alignedFaultAddress, pagesNeeded);
 
+	// map the following blocks as long as empty ones are available without waiting
+	uint64_t next = index + 1, lastBlock = (size - 1) >> sp->blockSizePower;
+	while (next < index + faultAround && next <= lastBlock && Syscall.TryWaitSemaphore(semEmpty)) {
+		MapWriterBlock(next, writeBuf + (next << sp->blockSizePower), sp->pagesPerBlock);
+		next++;
+	}
+	mappedBlocks = max(mappedBlocks, next);
+}
+
+// takes a block from the pool and maps it into the writer buffer; requires an empty-block credit
+void VortexC::MapWriterBlock(uint64_t index, char* alignedFaultAddress, uint64_t pagesNeeded) {
 	// create a new block allocation
 	BlockState* pBlock = new (pagesNeeded) BlockState;
-#ifdef _WIN32
-	sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN());
+#ifdef PFN_POOL
+	sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN(), pBlock->node);
 #else
-	pBlock->SetPFN(sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN()));
+	pBlock->SetPFN(sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN(), pBlock->node));
 #endif
 	// record block data and map the block.
 	sp->MapBlock(bcWriter, alignedFaultAddress, pagesNeeded, (BlockType*)pBlock->GetPFN());
@@ -135,7 +164,7 @@ void VortexC::HandleReadFault(char* alignedFaultAddress) {
 			bool isReader = IsReaderAddress(block->virtualPtr);
 			BufferConfig* bc = isReader ? bcReader : bcWriter;
 			sp->UnmapBlock(bc, block->virtualPtr, block->numPages);
-			sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN());
+			sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN(), block->node);
 			delete block;
 		}
 
@@ -209,19 +238,26 @@ void VortexC::Reset(void) {
 		bool isReader     = IsReaderAddress(block->virtualPtr);
 		BufferConfig* bc  = isReader ? bcReader : bcWriter;
 		sp->UnmapBlock(bc, block->virtualPtr, block->numPages);
-		sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN());
+		sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN(), block->node);
 		delete block;
 
 		Syscall.EnterCS(cs);
 	}
 	Syscall.LeaveCS(cs);
 	curReadOff = -1;
+	releasedBlocks = mappedBlocks = 0;
+	faultAround    = 1;
+}
+
+// caps the number of blocks mapped per sequential write fault; 1 maps only the faulting block
+void VortexC::SetFaultAround(uint64_t maxBlocks) {
+	maxFaultAround = max((uint64_t)1, min((uint64_t)FAULT_AROUND_MAX, maxBlocks));
 }
 
 // releases the last blocks to the consumer
 void VortexC::FinishedWrite(void) {
-	// Release L+1 still-pending buffers.
-	Syscall.FreeSemaphore(semFull, comeBackProducer + 1);
+	// release the still-pending buffers: the last L+1 written plus any mapped ahead by fault-around
+	Syscall.FreeSemaphore(semFull, max(mappedBlocks, releasedBlocks + comeBackProducer + 1) - releasedBlocks);
 }
 
 // attempts to read the last byte of the stream
@@ -20,6 +20,9 @@
 #include "SystemFunctions.h"
 #include <inttypes.h>
 
+// upper bound on the blocks a sequential write fault maps at once
+#define FAULT_AROUND_MAX	8
+
 class StreamPool;
 class VortexC : public Stream {
 	// base stream structures
@@ -42,9 +45,16 @@ class VortexC : public Stream {
 	char*		 lastWriterPosition;
 	CSType*      cs;
 
+	// writer fault-around
+	uint64_t     releasedBlocks;   // blocks handed to the consumer through semFull
+	uint64_t     mappedBlocks;     // one past the highest block mapped into the writer buffer
+	uint64_t     faultAround;      // blocks mapped by the current write fault; doubles while faults stay sequential
+	uint64_t     maxFaultAround;
+
 	// internal fault handling
 	void		 HandleWriteFault(char* faultAddress, char* alignedFaultAddress);
 	void		 HandleReadFault(char* alignedFaultAddress);
+	void		 MapWriterBlock(uint64_t index, char* blockAddress, uint64_t pagesNeeded);
 	bool		 IsReaderAddress(char* addr);
 public:
 	VortexC(uint64_t size, uint64_t blockSizePower, uint64_t comeBackConsumer, uint64_t comeBackProducer, uint64_t writeAhead);
@@ -54,6 +64,7 @@ public:
 	char*		 GetReadBuf(void);
 	char*		 GetWriteBuf(void);
 	void		 Reset(void);		  
+	void		 SetFaultAround(uint64_t maxBlocks);
 
 	uint64_t	 GetProducerComeback (void) { return comeBackProducer;  }
 	uint64_t	 GetConsumerComeback (void) { return comeBackConsumer;  }
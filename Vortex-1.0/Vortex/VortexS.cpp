@@ -56,13 +56,13 @@ char* VortexS::GetWriteBuf(void) {
 
 // retrieve the number of pages in the first block
 uint64_t VortexS::GetFirstBlockSize() {
-#ifdef _WIN32
-	// Windows can save memory on the first block by only mapping needed pages
+#ifdef PFN_POOL
+	// PFN pools can save memory on the first block by only mapping needed pages
 	uint64_t pageSpacing = (bc->buf - bc->bufMain) >> sp->pageSizePower;
 	uint64_t pagesNeeded = sp->pagesPerBlock - (pageSpacing & (sp->pagesPerBlock - 1));
 	return   pagesNeeded;
 #else
-	// Linux requires blockSize aligned memory mappings
+	// mremap-based Linux requires blockSize aligned memory mappings
 	return   sp->pagesPerBlock;
 #endif
 }
@@ -74,12 +74,12 @@ void VortexS::HandleWriteFault(char* faultAddress, char* alignedFaultAddress) {
 
 	// added for PFN-based mapping
 	uint64_t pagesNeeded, pageSpacing;
-#ifdef _WIN32
-	// Windows can save memory on the first block by only mapping needed pages
+#ifdef PFN_POOL
+	// PFN pools can save memory on the first block by only mapping needed pages
 	if (index != 0) pageSpacing = (alignedFaultAddress - bc->bufMain) >> sp->pageSizePower;
 	else            pageSpacing = (faultAddress - bc->bufMain) >> sp->pageSizePower;
 #else
-	// Linux requires blockSize aligned memory mappings
+	// mremap-based Linux requires blockSize aligned memory mappings
 	pageSpacing = (alignedFaultAddress - bc->bufMain) >> sp->pageSizePower;
 #endif
 	if (index != 0) pagesNeeded = sp->pagesPerBlock;
@@ -105,10 +105,10 @@ void VortexS::HandleWriteFault(char* faultAddress, char* alignedFaultAddress) {
 	// otherwise, obtain a new block and map
 	else {
 		BlockState* pBlock = new (pagesNeeded) BlockState;
-#ifdef _WIN32
-		sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN());
+#ifdef PFN_POOL
+		sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN(), pBlock->node);
 #else
-		pBlock->SetPFN(sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN()));
+		pBlock->SetPFN(sp->GetNewBlock(pagesNeeded, (BlockType*)pBlock->GetPFN(), pBlock->node));
 #endif
 		// record block data and map the block
 		sp->MapBlock(bc, dest, pagesNeeded, (BlockType*)pBlock->GetPFN());
@@ -132,7 +132,7 @@ void VortexS::HandleReadFault(char* faultAddress, char* alignedFaultAddress) {
 		if (it != physicalBlockMapped.end()) {
 			BlockState* block = it->second;
 			sp->UnmapBlock(bc, block->virtualPtr, block->numPages);
-			sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN());
+			sp->ReturnFreeBlock(block->numPages, (BlockType*)block->GetPFN(), block->node);
 			delete it->second;
 			physicalBlockMapped.erase(it);
 		}
@@ -182,7 +182,7 @@ void VortexS::Reset(void) {
 			Syscall.RemoveGuard(pBlock->virtualPtr);
 #endif
 			sp->UnmapBlock(bc, pBlock->virtualPtr, pBlock->numPages);
-			sp->ReturnFreeBlock(pBlock->numPages, (BlockType*)pBlock->GetPFN());
+			sp->ReturnFreeBlock(pBlock->numPages, (BlockType*)pBlock->GetPFN(), pBlock->node);
 			delete it->second;
 		}
 		it++;
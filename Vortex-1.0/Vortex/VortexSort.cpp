@@ -96,6 +96,7 @@ VortexSort<ItemType>::VortexSort(uint64_t size, uint64_t blockSizePower) {
 	// setup bucket pointers and a stream pool for memory management
 	buckets = (ItemType**)Syscall.AllocAligned(sizeof(ItemType*) * nBuckets[0] * (maxDepth + 1), 64);
 	sp      = new StreamPool(blockSizePower);
+	sp->SetColors(cpuId.PageColors(sp->pageSize));
 
 	// setup RAM necessary for stream pool
 	InitializeRAM(max((int)nBuckets[0], 32), max((int)nBuckets[1], 32));
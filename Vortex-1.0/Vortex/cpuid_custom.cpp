@@ -31,4 +31,42 @@ VortexCpuId::VortexCpuId() {
 		uint64_t xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
 		avx = (xcrFeatureMask & 0x6) == 0x6;
 	}
+
+	// ---------- cache geometry -----------
+	// Intel reports caches in leaf 4, AMD in 0x8000001D; both share the same register layout
+	Syscall.cpuid(result, 0);
+	bool amd  = result[1] == 0x68747541;		// "Auth"enticAMD
+	int  leaf = amd ? 0x8000001D : 4;
+	if (amd) {
+		Syscall.cpuid(result, 0x80000001);
+		if ((result[2] & (1 << 22)) == 0) return;	// no topology extensions
+	}
+	else if (result[0] < 4) return;
+
+	for (int i = 0; i < 16; i++) {
+		Syscall.cpuidex(result, leaf, i);
+		uint64_t type = result[0] & 0x1F;
+		if (type == 0) break;
+		if (type == 2) continue;					// instruction cache
+
+		uint64_t level = (result[0] >> 5) & 0x7;
+		uint64_t ways  = ((result[1] >> 22) & 0x3FF) + 1;
+		uint64_t parts = ((result[1] >> 12) & 0x3FF) + 1;
+		uint64_t line  = (result[1] & 0xFFF) + 1;
+		uint64_t size  = ways * parts * line * ((uint64_t)result[2] + 1);
+		lineSize = line;
+		if (level == 2) { l2Size = size; l2Ways = ways; }
+		if (size > llcSize) { llcSize = size; llcWays = ways; }
+	}
+}
+
+// number of page colors that spreads stream heads over every set of the L2; together with the cache-line
+// stagger of VortexS, consecutive buckets then start in different sets. The LLC is not used as its
+// slices are selected by a hash of physical address bits that virtual staggering cannot influence.
+uint64_t VortexCpuId::PageColors(uint64_t pageSize) {
+	if (l2Size == 0 || l2Ways == 0) return DEFAULT_COLORS;
+
+	uint64_t colors = 1;
+	while (colors * pageSize * l2Ways < l2Size) colors <<= 1;
+	return colors;
 }
\ No newline at end of file
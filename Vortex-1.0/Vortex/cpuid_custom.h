@@ -25,5 +25,12 @@
 class VortexCpuId {
 public:
 	bool avx = false;
+
+	// cache geometry from the deterministic cache parameters leaf; zero when not reported
+	uint64_t l2Size  = 0, l2Ways  = 0;
+	uint64_t llcSize = 0, llcWays = 0;
+	uint64_t lineSize = 64;
+
 	VortexCpuId();
+	uint64_t PageColors(uint64_t pageSize);
 };
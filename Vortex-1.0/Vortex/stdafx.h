@@ -28,12 +28,14 @@
 #include <stdexcept>
 #include <iostream>
 #include <thread>
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <math.h>
 #include <stack>
 #include <map>
 #include <set>
+#include <list>
 
 using namespace std;
 
@@ -56,6 +58,7 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 #include "Stream.h"              
 
 #include "StreamPool.h"        
+#include "MemoryGovernor.h"
 #include "StreamManager.h"       
 #include "VortexC.h"            
 #include "VortexS.h"             